@@ -1508,6 +1508,8 @@ static int gswig_const_meep_time_sink_Nf2ffCalc = meep::Nf2ffCalc;
 static int gswig_const_meep_time_sink_Nf2ffComm = meep::Nf2ffComm;
 static int gswig_const_meep_time_sink_Nf2ffOutput = meep::Nf2ffOutput;
 static int gswig_const_meep_time_sink_ModeVolCalc = meep::ModeVolCalc;
+static int gswig_const_meep_time_sink_OutputStaging = meep::OutputStaging;
+static int gswig_const_meep_time_sink_OutputWaiting = meep::OutputWaiting;
 static int gswig_const_meep_time_sink_Other = meep::Other;
 static int gswig_const_meep_grace_type_XY = meep::XY;
 static int gswig_const_meep_grace_type_ERROR_BARS = meep::ERROR_BARS;
@@ -15652,6 +15654,118 @@ _wrap_meep_h5file_close_data (SCM s_0)
 }
 
 
+static SCM
+_wrap_meep_h5file_set_async (SCM s_0, SCM s_1, SCM s_2)
+{
+#define FUNC_NAME "meep-h5file-set-async"
+  bool arg1 ;
+  double arg2 ;
+  meep::fields *arg3 = (meep::fields *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (bool) SCM_NFALSEP(s_0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (meep::fields *)SWIG_MustGetPtr(s_2, SWIGTYPE_p_meep__fields, 3, 0);
+  }
+  meep::h5file::set_async(arg1,arg2,arg3);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_meep_h5file_flush (SCM s_0)
+{
+#define FUNC_NAME "meep-h5file-flush"
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  meep::h5file::flush();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_meep_h5file_set_extend_block (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "meep-h5file-set-extend-block"
+  meep::h5file *arg1 = (meep::h5file *) 0 ;
+  int arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::h5file *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__h5file, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_extend_block(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_meep_h5file_set_append_buffer (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "meep-h5file-set-append-buffer"
+  meep::h5file *arg1 = (meep::h5file *) 0 ;
+  int arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::h5file *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__h5file, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_append_buffer(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_meep_h5file_flush_appended (SCM s_0)
+{
+#define FUNC_NAME "meep-h5file-flush-appended"
+  meep::h5file *arg1 = (meep::h5file *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::h5file *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__h5file, 1, 0);
+  }
+  (arg1)->flush_appended();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
 static SCM
 _wrap_DEFAULT_SUBPIXEL_TOL(SCM s_0)
 {
@@ -33438,6 +33552,34 @@ _wrap_meep_time_sink_ModeVolCalc(SCM s_0)
 #undef FUNC_NAME
 }
 
+static SCM
+_wrap_meep_time_sink_OutputStaging(SCM s_0)
+{
+#define FUNC_NAME "meep-time-sink-OutputStaging"
+  SCM gswig_result;
+  
+  {
+    gswig_result = scm_long2num(gswig_const_meep_time_sink_OutputStaging);
+  }
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+static SCM
+_wrap_meep_time_sink_OutputWaiting(SCM s_0)
+{
+#define FUNC_NAME "meep-time-sink-OutputWaiting"
+  SCM gswig_result;
+  
+  {
+    gswig_result = scm_long2num(gswig_const_meep_time_sink_OutputWaiting);
+  }
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
 
 static SCM
 _wrap_meep_time_sink_Other(SCM s_0)
@@ -48141,6 +48283,233 @@ _wrap_snapshot_add_component (SCM s_0, SCM s_1, SCM s_2)
 }
 
 
+static SCM
+_wrap_snapshot_set_frequencies (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "snapshot-set-frequencies"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_frequencies(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_set_parallel_output (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "snapshot-set-parallel-output"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  bool arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (bool) SCM_NFALSEP(s_1);
+  }
+  (arg1)->set_parallel_output(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_set_complex_output (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "snapshot-set-complex-output"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  bool arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (bool) SCM_NFALSEP(s_1);
+  }
+  (arg1)->set_complex_output(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_set_compression (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "snapshot-set-compression"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  int arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_compression(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_set_slab_output (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "snapshot-set-slab-output"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  int arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_slab_output(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_set_box_filter (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "snapshot-set-box-filter"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  bool arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (bool) SCM_NFALSEP(s_1);
+  }
+  (arg1)->set_box_filter(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_step (SCM s_0)
+{
+#define FUNC_NAME "snapshot-step"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  (arg1)->step();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_set_window (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "snapshot-set-window"
+  meep::snapshot *arg1 = (meep::snapshot *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::snapshot *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__snapshot, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_window(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_snapshot_dfts_converged (SCM s_0)
+{
+#define FUNC_NAME "snapshot-dfts-converged"
+  double arg1 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  bool result;
+  
+  {
+    arg1 = (double) scm_num2dbl(s_0, FUNC_NAME);
+  }
+  result = (bool)meep::snapshot::dfts_converged(arg1);
+  {
+    gswig_result = SCM_BOOL(result);
+  }
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
 static SCM
 _wrap_snapshot_create (SCM s_0)
 {
@@ -48570,6 +48939,418 @@ _wrap_nf2ff_process (SCM s_0)
 }
 
 
+static SCM
+_wrap_nf2ff_set_frequencies (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "nf2ff-set-frequencies"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_frequencies(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_parallel_output (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-parallel-output"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  bool arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (bool) SCM_NFALSEP(s_1);
+  }
+  (arg1)->set_parallel_output(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_complex_output (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-complex-output"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  bool arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (bool) SCM_NFALSEP(s_1);
+  }
+  (arg1)->set_complex_output(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_compression (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-compression"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  int arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_compression(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_fft (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-fft"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  int arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_fft(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_angles (SCM s_0, SCM s_1, SCM s_2, SCM s_3, SCM s_4, SCM s_5, SCM s_6)
+{
+#define FUNC_NAME "nf2ff-set-angles"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  double arg5 ;
+  double arg6 ;
+  int arg7 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  {
+    arg5 = (double) scm_num2dbl(s_4, FUNC_NAME);
+  }
+  {
+    arg6 = (double) scm_num2dbl(s_5, FUNC_NAME);
+  }
+  {
+    arg7 = (int) scm_num2int(s_6, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_angles(arg2,arg3,arg4,arg5,arg6,arg7);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_fibonacci (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "nf2ff-set-fibonacci"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  int arg2 ;
+  double arg3 ;
+  double arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (double) scm_num2dbl(s_3, FUNC_NAME);
+  }
+  (arg1)->set_fibonacci(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_add_cone (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "nf2ff-add-cone"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  double arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (double) scm_num2dbl(s_3, FUNC_NAME);
+  }
+  (arg1)->add_cone(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_input_power (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-input-power"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  double arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  (arg1)->set_input_power(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_far_output (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-far-output"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  bool arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (bool) SCM_NFALSEP(s_1);
+  }
+  (arg1)->set_far_output(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_time_domain (SCM s_0, SCM s_1)
+{
+#define FUNC_NAME "nf2ff-set-time-domain"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  double arg2 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  (arg1)->set_time_domain(arg2);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_array (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "nf2ff-set-array"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  int arg2 ;
+  int arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (int) scm_num2int(s_1, SCM_ARG1, FUNC_NAME);
+  }
+  {
+    arg3 = (int) scm_num2int(s_2, SCM_ARG1, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_array(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_set_window (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "nf2ff-set-window"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_window(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_step (SCM s_0)
+{
+#define FUNC_NAME "nf2ff-step"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  (arg1)->step();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_nf2ff_create (SCM s_0)
+{
+#define FUNC_NAME "nf2ff-create"
+  meep::nf2ff *arg1 = (meep::nf2ff *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::nf2ff *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__nf2ff, 1, 0);
+  }
+  (arg1)->create();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
 static SCM
 _wrap_new_mode_volume__SWIG_0 (int argc, SCM *argv)
 {
@@ -48905,6 +49686,142 @@ _wrap_mode_volume_output (SCM s_0)
 }
 
 
+static SCM
+_wrap_mode_volume_set_frequencies (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "mode-volume-set-frequencies"
+  meep::mode_volume *arg1 = (meep::mode_volume *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::mode_volume *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__mode_volume, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_frequencies(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_mode_volume_create (SCM s_0)
+{
+#define FUNC_NAME "mode-volume-create"
+  meep::mode_volume *arg1 = (meep::mode_volume *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::mode_volume *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__mode_volume, 1, 0);
+  }
+  (arg1)->create();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_mode_volume_set_purcell (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "mode-volume-set-purcell"
+  meep::mode_volume *arg1 = (meep::mode_volume *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  double arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::mode_volume *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__mode_volume, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (double) scm_num2dbl(s_3, FUNC_NAME);
+  }
+  (arg1)->set_purcell(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_mode_volume_set_window (SCM s_0, SCM s_1, SCM s_2, SCM s_3)
+{
+#define FUNC_NAME "mode-volume-set-window"
+  meep::mode_volume *arg1 = (meep::mode_volume *) 0 ;
+  double arg2 ;
+  double arg3 ;
+  int arg4 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::mode_volume *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__mode_volume, 1, 0);
+  }
+  {
+    arg2 = (double) scm_num2dbl(s_1, FUNC_NAME);
+  }
+  {
+    arg3 = (double) scm_num2dbl(s_2, FUNC_NAME);
+  }
+  {
+    arg4 = (int) scm_num2int(s_3, SCM_ARG1, FUNC_NAME);
+  }
+  (arg1)->set_window(arg2,arg3,arg4);
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
+static SCM
+_wrap_mode_volume_step (SCM s_0)
+{
+#define FUNC_NAME "mode-volume-step"
+  meep::mode_volume *arg1 = (meep::mode_volume *) 0 ;
+  SCM gswig_result;
+  SWIGUNUSED int gswig_list_p = 0;
+  
+  {
+    arg1 = (meep::mode_volume *)SWIG_MustGetPtr(s_0, SWIGTYPE_p_meep__mode_volume, 1, 0);
+  }
+  (arg1)->step();
+  gswig_result = SCM_UNSPECIFIED;
+  
+  
+  return gswig_result;
+#undef FUNC_NAME
+}
+
+
 static SCM
 _wrap_MEEP_CTL_SWIG_HPP(SCM s_0)
 {
@@ -50686,6 +51603,11 @@ SWIG_init(void)
   scm_c_define_gsubr("meep-h5file-prevent-deadlock", 1, 0, 0, (swig_guile_proc) _wrap_meep_h5file_prevent_deadlock);
   scm_c_define_gsubr("meep-h5file-open-data", 2, 0, 0, (swig_guile_proc) _wrap_meep_h5file_open_data);
   scm_c_define_gsubr("meep-h5file-close-data", 1, 0, 0, (swig_guile_proc) _wrap_meep_h5file_close_data);
+  scm_c_define_gsubr("meep-h5file-set-async", 3, 0, 0, (swig_guile_proc) _wrap_meep_h5file_set_async);
+  scm_c_define_gsubr("meep-h5file-flush", 0, 0, 0, (swig_guile_proc) _wrap_meep_h5file_flush);
+  scm_c_define_gsubr("meep-h5file-set-extend-block", 2, 0, 0, (swig_guile_proc) _wrap_meep_h5file_set_extend_block);
+  scm_c_define_gsubr("meep-h5file-set-append-buffer", 2, 0, 0, (swig_guile_proc) _wrap_meep_h5file_set_append_buffer);
+  scm_c_define_gsubr("meep-h5file-flush-appended", 1, 0, 0, (swig_guile_proc) _wrap_meep_h5file_flush_appended);
   scm_c_define_gsubr("DEFAULT-SUBPIXEL-TOL", 0, 0, 0, (swig_guile_proc) _wrap_DEFAULT_SUBPIXEL_TOL);
   scm_c_define_gsubr("DEFAULT-SUBPIXEL-MAXEVAL", 0, 0, 0, (swig_guile_proc) _wrap_DEFAULT_SUBPIXEL_MAXEVAL);
   SWIG_TypeClientData(SWIGTYPE_p_meep__material_function, (void *) &_swig_guile_clientdatameep_material_function);
@@ -51114,6 +52036,8 @@ SWIG_init(void)
   scm_c_define_gsubr("meep-time-sink-Nf2ffComm", 0, 0, 0, (swig_guile_proc) _wrap_meep_time_sink_Nf2ffComm);
   scm_c_define_gsubr("meep-time-sink-Nf2ffOutput", 0, 0, 0, (swig_guile_proc) _wrap_meep_time_sink_Nf2ffOutput);
   scm_c_define_gsubr("meep-time-sink-ModeVolCalc", 0, 0, 0, (swig_guile_proc) _wrap_meep_time_sink_ModeVolCalc);
+  scm_c_define_gsubr("meep-time-sink-OutputStaging", 0, 0, 0, (swig_guile_proc) _wrap_meep_time_sink_OutputStaging);
+  scm_c_define_gsubr("meep-time-sink-OutputWaiting", 0, 0, 0, (swig_guile_proc) _wrap_meep_time_sink_OutputWaiting);
   scm_c_define_gsubr("meep-time-sink-Other", 0, 0, 0, (swig_guile_proc) _wrap_meep_time_sink_Other);
   scm_c_define_gsubr("meep-derived-component-func", 4, 0, 0, (swig_guile_proc) _wrap_meep_derived_component_func);
   SWIG_TypeClientData(SWIGTYPE_p_meep__fields, (void *) &_swig_guile_clientdatameep_fields);
@@ -51297,17 +52221,46 @@ SWIG_init(void)
   scm_c_define_gsubr("delete-snapshot", 1, 0, 0, (swig_guile_proc) _wrap_delete_snapshot);
   scm_c_define_gsubr("snapshot-output", 1, 0, 0, (swig_guile_proc) _wrap_snapshot_output);
   scm_c_define_gsubr("snapshot-add-component", 3, 0, 0, (swig_guile_proc) _wrap_snapshot_add_component);
+  scm_c_define_gsubr("snapshot-set-frequencies", 4, 0, 0, (swig_guile_proc) _wrap_snapshot_set_frequencies);
+  scm_c_define_gsubr("snapshot-set-parallel-output", 2, 0, 0, (swig_guile_proc) _wrap_snapshot_set_parallel_output);
+  scm_c_define_gsubr("snapshot-set-complex-output", 2, 0, 0, (swig_guile_proc) _wrap_snapshot_set_complex_output);
+  scm_c_define_gsubr("snapshot-set-compression", 2, 0, 0, (swig_guile_proc) _wrap_snapshot_set_compression);
+  scm_c_define_gsubr("snapshot-set-slab-output", 2, 0, 0, (swig_guile_proc) _wrap_snapshot_set_slab_output);
+  scm_c_define_gsubr("snapshot-set-box-filter", 2, 0, 0, (swig_guile_proc) _wrap_snapshot_set_box_filter);
+  scm_c_define_gsubr("snapshot-step", 1, 0, 0, (swig_guile_proc) _wrap_snapshot_step);
+  scm_c_define_gsubr("snapshot-set-window", 4, 0, 0, (swig_guile_proc) _wrap_snapshot_set_window);
+  scm_c_define_gsubr("snapshot-dfts-converged", 1, 0, 0, (swig_guile_proc) _wrap_snapshot_dfts_converged);
   scm_c_define_gsubr("snapshot-create", 1, 0, 0, (swig_guile_proc) _wrap_snapshot_create);
   SWIG_TypeClientData(SWIGTYPE_p_meep__nf2ff, (void *) &_swig_guile_clientdatanf2ff);
   scm_c_define_gsubr("new-nf2ff", 0, 0, 1, (swig_guile_proc) _wrap_new_nf2ff);
   ((swig_guile_clientdata *)(SWIGTYPE_p_meep__nf2ff->clientdata))->destroy = (guile_destructor) _wrap_delete_nf2ff;
   scm_c_define_gsubr("delete-nf2ff", 1, 0, 0, (swig_guile_proc) _wrap_delete_nf2ff);
   scm_c_define_gsubr("nf2ff-process", 1, 0, 0, (swig_guile_proc) _wrap_nf2ff_process);
+  scm_c_define_gsubr("nf2ff-set-frequencies", 4, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_frequencies);
+  scm_c_define_gsubr("nf2ff-set-parallel-output", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_parallel_output);
+  scm_c_define_gsubr("nf2ff-set-complex-output", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_complex_output);
+  scm_c_define_gsubr("nf2ff-set-compression", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_compression);
+  scm_c_define_gsubr("nf2ff-set-fft", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_fft);
+  scm_c_define_gsubr("nf2ff-set-angles", 7, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_angles);
+  scm_c_define_gsubr("nf2ff-set-fibonacci", 4, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_fibonacci);
+  scm_c_define_gsubr("nf2ff-add-cone", 4, 0, 0, (swig_guile_proc) _wrap_nf2ff_add_cone);
+  scm_c_define_gsubr("nf2ff-set-input-power", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_input_power);
+  scm_c_define_gsubr("nf2ff-set-far-output", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_far_output);
+  scm_c_define_gsubr("nf2ff-set-time-domain", 2, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_time_domain);
+  scm_c_define_gsubr("nf2ff-set-array", 4, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_array);
+  scm_c_define_gsubr("nf2ff-set-window", 4, 0, 0, (swig_guile_proc) _wrap_nf2ff_set_window);
+  scm_c_define_gsubr("nf2ff-step", 1, 0, 0, (swig_guile_proc) _wrap_nf2ff_step);
+  scm_c_define_gsubr("nf2ff-create", 1, 0, 0, (swig_guile_proc) _wrap_nf2ff_create);
   SWIG_TypeClientData(SWIGTYPE_p_meep__mode_volume, (void *) &_swig_guile_clientdatamode_volume);
   scm_c_define_gsubr("new-mode-volume", 0, 0, 1, (swig_guile_proc) _wrap_new_mode_volume);
   ((swig_guile_clientdata *)(SWIGTYPE_p_meep__mode_volume->clientdata))->destroy = (guile_destructor) _wrap_delete_mode_volume;
   scm_c_define_gsubr("delete-mode-volume", 1, 0, 0, (swig_guile_proc) _wrap_delete_mode_volume);
   scm_c_define_gsubr("mode-volume-output", 1, 0, 0, (swig_guile_proc) _wrap_mode_volume_output);
+  scm_c_define_gsubr("mode-volume-set-frequencies", 4, 0, 0, (swig_guile_proc) _wrap_mode_volume_set_frequencies);
+  scm_c_define_gsubr("mode-volume-create", 1, 0, 0, (swig_guile_proc) _wrap_mode_volume_create);
+  scm_c_define_gsubr("mode-volume-set-purcell", 4, 0, 0, (swig_guile_proc) _wrap_mode_volume_set_purcell);
+  scm_c_define_gsubr("mode-volume-set-window", 4, 0, 0, (swig_guile_proc) _wrap_mode_volume_set_window);
+  scm_c_define_gsubr("mode-volume-step", 1, 0, 0, (swig_guile_proc) _wrap_mode_volume_step);
   scm_c_define_gsubr("MEEP-CTL-SWIG-HPP", 0, 0, 0, (swig_guile_proc) _wrap_MEEP_CTL_SWIG_HPP);
   scm_c_define_gsubr("vec-to-vector3", 1, 0, 0, (swig_guile_proc) _wrap_vec_to_vector3);
   scm_c_define_gsubr("vector3-to-vec", 1, 0, 0, (swig_guile_proc) _wrap_vector3_to_vec);
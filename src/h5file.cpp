@@ -1,874 +1,1504 @@
-/* Copyright (C) 2005-2012 Massachusetts Institute of Technology
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation; either version 2 of the License, or
- * (at your option) any later version.
- *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program; if not, write to the Free Software
- * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
- */
-
-#include <cstdio>
-#include <cstdlib>
-#include <string.h>
-
-#include "meep.hpp"
-
-#define CHECK(condition, message) do { \
-     if (!(condition))  { \
-          abort("error on line %d of " __FILE__ ": " \
-                  message "\n", __LINE__); \
-     } \
-} while (0)
-
-#include "config.h"
-
-#ifdef HAVE_HDF5
-
-/* don't use new HDF5 1.8 API (which isn't even fully documented yet, grrr) */
-#  define H5_USE_16_API 1
-
-#  include <hdf5.h>
-
-/* HDF5 changed this datatype in their interfaces starting in version 1.6.4 */
-#  if H5_VERS_MAJOR > 1 \
-   || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR > 6) \
-   || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR == 6 && H5_VERS_RELEASE > 3)
-     typedef hsize_t start_t;
-#  else
-     typedef hssize_t start_t;
-#  endif
-
-#else
-typedef int hid_t;
-#endif
-
-
-#define HID(x) (*((hid_t *) (x)))
-
-/*****************************************************************************/
-/* If we have the H5Pset_fapl_mpio function (which is available if HDF5 was
-   compiled for MPI), then we can perform collective file i/o operations
-   (e.g. all processes call H5Fcreate at the same time to create one file).
-
-   If we don't, however, then we deal with it by having one process
-   work with the file at a time: "exclusive" access.  The following
-   macro helps us select different bits of code depending upon whether
-   this is the case. */
-
-#ifdef HAVE_H5PSET_MPI /* old name for this routine */
-#  define H5Pset_fapl_mpio H5Pset_mpi
-#  ifndef HAVE_H5PSET_FAPL_MPIO
-#    define HAVE_H5PSET_FAPL_MPIO 1
-#  endif
-#endif
-
-#if defined(HAVE_H5PSET_FAPL_MPIO) || !defined(HAVE_MPI)
-#  define IF_EXCLUSIVE(yes,no) no
-#else
-#  define IF_EXCLUSIVE(yes,no) yes
-static int h5io_critical_section_tag = 0;
-#endif
-
-/*****************************************************************************/
-/* Normally, HDF5 prints out all sorts of error messages, e.g. if a dataset
-   can't be found, in addition to returning an error code.  The following
-   macro can be wrapped around code to temporarily suppress error messages. */
-
-#define SUPPRESS_HDF5_ERRORS(statements) { \
-     H5E_auto_t xxxxx_err_func; \
-     void *xxxxx_err_func_data; \
-     H5Eget_auto(&xxxxx_err_func, &xxxxx_err_func_data); \
-     H5Eset_auto(NULL, NULL); \
-     { statements; } \
-     H5Eset_auto(xxxxx_err_func, xxxxx_err_func_data); \
-}
-
-/*****************************************************************************/
-
-#ifdef HAVE_HDF5
-static bool dataset_exists(hid_t id, const char *name)
-{
-     hid_t data_id;
-     SUPPRESS_HDF5_ERRORS(data_id = H5Dopen(id, name));
-     if (data_id >= 0)
-          H5Dclose(data_id);
-     return (data_id >= 0);
-}
-#endif
-
-/*****************************************************************************/
-
-namespace meep {
-
-// lazy file creation & locking
-void *h5file::get_id() {
-  if (HID(id) < 0) {
-    if (parallel)
-      all_wait();
-
-#ifdef HAVE_HDF5
-    hid_t access_props = H5Pcreate (H5P_FILE_ACCESS);
-#  ifdef HAVE_MPI
-#    ifdef HAVE_H5PSET_FAPL_MPIO
-    if (parallel)
-      H5Pset_fapl_mpio(access_props, MPI_COMM_WORLD, MPI_INFO_NULL);
-#    else
-    if (parallel)
-      begin_critical_section(h5io_critical_section_tag);
-#    endif
-#  endif
-
-    if (mode != WRITE || IF_EXCLUSIVE(parallel && !am_master(), 0))
-      HID(id) = H5Fopen(filename,
-			mode == READONLY ? H5F_ACC_RDONLY : H5F_ACC_RDWR,
-			access_props);
-    else
-      HID(id) = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, access_props);
-    
-    H5Pclose(access_props);
-#endif
-  }
-  return id;
-}
-
-// hackery: in some circumstances, for the exclusive-access mode
-// we must close the id (i.e. the file) in order to prevent deadlock.
-void h5file::prevent_deadlock() {
-  IF_EXCLUSIVE(if (parallel) close_id(), (void) 0);
-}
-
-void h5file::close_id() {
-  unset_cur();
-  if (HID(id) >= 0)
-    if (mode == WRITE) mode = READWRITE; // don't re-create on re-open
-#ifdef HAVE_HDF5
-  if (HID(id) >= 0) {
-    H5Fclose(HID(id));
-    IF_EXCLUSIVE(if (parallel)
-		 end_critical_section(h5io_critical_section_tag++),
-		 (void) 0);
-  }
-#endif
-  HID(id) = -1;
-}
-
-/* note: if parallel is true, then *all* processes must call this,
-   and all processes will use I/O. */
-h5file::h5file(const char *filename_, access_mode m, bool parallel_) {
-  cur_dataname = NULL;
-  id = (void*) malloc(sizeof(hid_t));
-  cur_id = (void*) malloc(sizeof(hid_t));
-  HID(id) = -1;
-  HID(cur_id) = -1;
-  extending = 0;
-  filename = new char[strlen(filename_) + 1];
-  strcpy(filename, filename_);
-  mode = m;
-  parallel = parallel_;
-}
-
-h5file::~h5file() {
-  close_id();
-  if (cur_dataname) free(cur_dataname); // allocated with realloc
-  for (h5file::extending_s *cur = extending; cur; ) {
-    h5file::extending_s *next = cur->next;
-    delete[] cur->dataname;
-    delete cur;
-    cur = next;
-  }
-  delete[] filename;
-  free(cur_id);
-  free(id);
-}
-
-bool h5file::ok() {
-  return (HID(get_id()) >= 0);
-}
-
-void h5file::remove() {
-  close_id();
-  if (mode == READWRITE) mode = WRITE; // now need to re-create file
-  for (h5file::extending_s *cur = extending; cur; ) {
-    h5file::extending_s *next = cur->next;
-    delete[] cur->dataname;
-    delete cur;
-    cur = next;
-  }
-  extending = 0;
-  
-  IF_EXCLUSIVE(if (parallel) all_wait(), (void) 0);
-  if (am_master() && std::remove(filename))
-    abort("error removing file %s", filename);
-}
-
-h5file::extending_s *h5file::get_extending(const char *dataname) const {
-  for (extending_s *cur = extending; cur; cur = cur->next)
-    if (!strcmp(dataname, cur->dataname))
-      return cur;
-  return NULL;
-}
-
-bool h5file::is_cur(const char *dataname) {
-  return cur_dataname && !strcmp(cur_dataname, dataname);
-}
-
-void h5file::unset_cur() {
-#ifdef HAVE_HDF5
-  if (HID(cur_id) >= 0)
-    H5Dclose(HID(cur_id));
-#endif
-  HID(cur_id) = -1;
-  if (cur_dataname)
-    cur_dataname[0] = 0;
-}
-
-void h5file::set_cur(const char *dataname, void *data_id) {
-#ifdef HAVE_HDF5
-  if (HID(cur_id) >= 0 && HID(cur_id) != HID(data_id))
-    H5Dclose(HID(cur_id));
-#endif
-  HID(cur_id) = HID(data_id);
-  if (!is_cur(dataname)) {
-    if (!cur_dataname || strlen(dataname) < strlen(cur_dataname))
-      cur_dataname = (char *) realloc(cur_dataname, strlen(dataname) + 1);
-    strcpy(cur_dataname, dataname);
-  }
-}
-
-void h5file::read_size(const char *dataname, int *rank, int *dims, int maxrank)
-{
-#ifdef HAVE_HDF5
-  if (parallel || am_master()) {
-    hid_t file_id = HID(get_id()), space_id, data_id;
-    
-    CHECK(file_id >= 0, "error opening HDF5 input file");
-    
-    if (is_cur(dataname))
-      data_id = HID(cur_id);
-    else {
-      CHECK(dataset_exists(file_id, dataname),
-	    "missing dataset in HDF5 file");
-      data_id = H5Dopen(file_id, dataname);
-      set_cur(dataname, &data_id);
-    }
-    space_id = H5Dget_space(data_id);
-    
-    *rank = H5Sget_simple_extent_ndims(space_id);
-    CHECK(*rank <= maxrank, "input array rank is too big");
-    
-    hsize_t *dims_copy = new hsize_t[*rank];
-    hsize_t *maxdims = new hsize_t[*rank];
-    H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
-    for (int i = 0; i < *rank; ++i) dims[i] = dims_copy[i];
-    delete[] maxdims;
-    delete[] dims_copy;
-    H5Sclose(space_id);
-  }
-
-  if (!parallel) {
-    *rank = broadcast(0, *rank);
-    broadcast(0, dims, *rank);
-    
-    if (*rank == 1 && dims[0] == 1)
-      *rank = 0;
-  }
-#endif
-}
-
-#ifdef HAVE_HDF5
-  /* check if the given name is a dataset in group_id, and if so set d
-     to point to a char** with a copy of name. */
-
-  static herr_t find_dataset(hid_t group_id, 
-			     const char *name, void *d)
-  {
-    char **dname = (char **) d;
-    H5G_stat_t info;
-
-    H5Gget_objinfo(group_id, name, 1, &info);
-    if (info.type == H5G_DATASET) {
-      *dname = new char[strlen(name) + 1];
-      strcpy(*dname, name);
-      return 1;
-    }
-    return 0;
-  }
-
-#endif
-
-#define REALNUM_H5T (sizeof(realnum) == sizeof(double) ? H5T_NATIVE_DOUBLE : H5T_NATIVE_FLOAT)
-
-realnum *h5file::read(const char *dataname,
-		     int *rank, int *dims, int maxrank)
-{
-#ifdef HAVE_HDF5
-  realnum *data = 0;
-  if (parallel || am_master()) {
-    int i, N;
-    hid_t file_id = HID(get_id()), space_id, data_id;
-    
-    CHECK(file_id >= 0, "error opening HDF5 input file");
-
-    bool close_data_id = true;
-    if (dataname) {
-      if (is_cur(dataname)) {
-	data_id = HID(cur_id);
-	close_data_id = false;
-      }
-      else {
-	CHECK(dataset_exists(file_id, dataname),
-	      "missing dataset in HDF5 file");
-	data_id = H5Dopen(file_id, dataname);
-      }
-    }
-    else { // find first dataset in file
-      char *dname = 0;
-      CHECK(H5Giterate(file_id, "/",NULL, find_dataset,&dname) >= 0 && dname,
-	    "cannot find dataset in HDF5 file");
-      if (is_cur(dname)) {
-	data_id = HID(cur_id);
-	close_data_id = false;
-      }
-      else {
-	data_id = H5Dopen(file_id, dname);
-      }
-      delete[] dname;
-    }
-    space_id = H5Dget_space(data_id);
-    
-    *rank = H5Sget_simple_extent_ndims(space_id);
-    CHECK(*rank <= maxrank, "input array rank is too big");
-    
-    hsize_t *dims_copy = new hsize_t[*rank];
-    hsize_t *maxdims = new hsize_t[*rank];
-    H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
-    delete[] maxdims;
-    for (N = 1, i = 0; i < *rank; ++i)
-      N *= (dims[i] = dims_copy[i]);
-    delete[] dims_copy;
-    H5Sclose(space_id);
-    
-    data = new realnum[N];
-    H5Dread(data_id, REALNUM_H5T, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-	    (void *) data);
-    
-    if (close_data_id)
-      H5Dclose(data_id);
-  }
-  
-  if (!parallel) {
-    *rank = broadcast(0, *rank);
-    broadcast(0, dims, *rank);
-    int N = 1;
-    for (int i = 0; i < *rank; ++i)
-      N *= dims[i];
-    if (!am_master())
-      data = new realnum[N];
-    broadcast(0, data, N);
-  }
-
-  if (*rank == 1 && dims[0] == 1)
-    *rank = 0;
-  
-  return data;
-#else
-  return NULL;
-#endif
-}
-
-char *h5file::read(const char *dataname)
-{
-#ifdef HAVE_HDF5
-  char *data = 0;
-  int len = 0;
-  if (parallel || am_master()) {
-    hid_t file_id = HID(get_id()), space_id, data_id, type_id;
-    
-    CHECK(file_id >= 0, "error opening HDF5 input file");
-    
-    if (is_cur(dataname))
-      unset_cur();
-
-    CHECK(dataset_exists(file_id, dataname),
-	  "missing dataset in HDF5 file");
-    
-    data_id = H5Dopen(file_id, dataname);
-    space_id = H5Dget_space(data_id);
-    type_id = H5Dget_type(data_id);
-    
-    CHECK(H5Sget_simple_extent_npoints(space_id) == 1,
-	  "expected single string in HDF5 file, but didn't get one");
-    
-    len = H5Tget_size(type_id);
-    H5Tclose(type_id);
-    type_id = H5Tcopy(H5T_C_S1);
-    H5Tset_size(type_id, len);
-    
-    data = new char[len];
-    H5Dread(data_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-	    (void *) data);
-    
-    H5Tclose(type_id);
-    H5Sclose(space_id);	  
-    H5Dclose(data_id);
-  }
-  
-  if (!parallel) {
-    len = broadcast(0, len);
-    if (!am_master())
-      data = new char[len];
-    broadcast(0, data, len);
-  }
-  
-  return data;
-#else
-  return NULL;
-#endif
-}
-
-/*****************************************************************************/
-
-/* Delete a dataset, if it exists.  In parallel mode, should be called
-   by all processors. */
-void h5file::remove_data(const char *dataname)
-{
-#ifdef HAVE_HDF5
-  hid_t file_id = HID(get_id());
-
-  if (is_cur(dataname))
-    unset_cur();
-
-  if (get_extending(dataname)) { // delete dataname from extending list
-    extending_s *prev = 0, *cur = extending;
-    for (; cur && strcmp(cur->dataname, dataname); cur = (prev = cur)->next) ;
-    if (!cur) abort("bug in remove_data: inconsistent get_extending");
-    if (prev)
-      prev->next = cur->next;
-    else
-      extending = cur->next;
-    delete[] cur->dataname;
-    delete cur;
-  }
-
-  if (dataset_exists(file_id, dataname)) {
-    /* this is hackish ...need to pester HDF5 developers to make
-       H5Gunlink a collective operation for parallel mode */
-    if (!parallel || am_master()) {
-      H5Gunlink(file_id, dataname);  /* delete it */
-      H5Fflush(file_id, H5F_SCOPE_GLOBAL);
-    }
-    IF_EXCLUSIVE((void) 0, if (parallel) all_wait());
-  }
-#endif
-}
-
-/* Create a dataset, for writing chunks etc.  Note that, in parallel mode,
-   this should be called by *all* processors, even those not writing any
-   data. */
-void h5file::create_data(const char *dataname, int rank, const int *dims,
-			 bool append_data, bool single_precision)
-{
-#ifdef HAVE_HDF5
-  int i;
-  hid_t file_id = HID(get_id()), space_id, data_id;
-  int rank1;
-
-  CHECK(rank >= 0, "negative rank");
-  
-  // stupid HDF5 has problems with rank 0
-  rank1 = (rank == 0 && !append_data) ? 1 : rank;
-  
-  CHECK(file_id >= 0, "error opening HDF5 output file");
-
-  unset_cur();
-  remove_data(dataname); // HDF5 gives error if we H5Dcreate existing dataset
-  
-  if (IF_EXCLUSIVE(!parallel || am_master(), 1)) {
-    hsize_t *dims_copy = new hsize_t[rank1 + append_data];
-    hsize_t *maxdims = new hsize_t[rank1 + append_data];
-    hsize_t N = 1;
-    for (i = 0; i < rank; ++i)
-      N *= (maxdims[i] = dims_copy[i] = dims[i]);
-    if (!rank)
-      maxdims[0] = dims_copy[0] = 1;
-    if (append_data) {
-      dims_copy[rank1] = 1;
-      maxdims[rank1] = H5S_UNLIMITED;
-    }
-    space_id = H5Screate_simple(rank1 + append_data, dims_copy, maxdims);
-    delete[] maxdims;
-    
-    /* For unlimited datasets, we need to specify the size of the
-       "chunks" in which the file data is allocated.  */
-    hid_t prop_id = H5Pcreate(H5P_DATASET_CREATE);
-    if (append_data) {
-      const int blocksize = 128;
-      // make a chunk at least blocksize elements for efficiency
-      dims_copy[rank1] = (blocksize + (N - 1)) / N;
-      H5Pset_chunk(prop_id, rank1 + 1, dims_copy);
-      dims_copy[rank1] = 1;
-    }
-    
-    delete[] dims_copy;
-    
-    hid_t type_id = single_precision ? H5T_NATIVE_FLOAT : REALNUM_H5T;
-    
-    data_id = H5Dcreate(file_id, dataname, type_id, space_id, prop_id);
-    if (data_id < 0) abort("Error creating dataset");
-    
-    H5Pclose(prop_id);
-  }
-  else {
-    data_id = H5Dopen(file_id, dataname);
-    CHECK(data_id >= 0, "missing dataset for subsequent processor");
-    space_id = H5Dget_space(data_id);
-  
-    CHECK(rank1 + append_data == H5Sget_simple_extent_ndims(space_id),
-	  "file data is inconsistent rank for subsequent processor");
-    
-    hsize_t *dims_copy = new hsize_t[rank1 + append_data];
-    hsize_t *maxdims = new hsize_t[rank1 + append_data];
-    H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
-    CHECK(!append_data || maxdims[rank1] == H5S_UNLIMITED,
-	  "file data is missing unlimited dimension for append_data");
-    delete[] maxdims;
-    for (i = 0; i < rank; ++i)
-      CHECK(dims[i] == (int) dims_copy[i],
-	    "file data is inconsistent size for subsequent processor");
-    if (rank < rank1)
-      CHECK(dims_copy[0] == 1, "rank-0 data is incorrect size");
-    
-    delete[] dims_copy;
-  }
-  
-  set_cur(dataname, &data_id);
-  H5Sclose(space_id);
-
-  if (append_data) {
-    extending_s *cur = new extending_s;
-    cur->dataname = new char[strlen(dataname) + 1];
-    strcpy(cur->dataname, dataname);
-    cur->dindex = 0;
-    cur->next = extending;
-    extending = cur;
-  }
-#else
-  abort("not compiled with HDF5, required for HDF5 output");
-#endif
-}
-
-/* Assumed data already created with append_data == true, and is
-   already open; extends it and increments cur_dindex.  Like
-   create_data, this is a collective operation and must be called from
-   all processes. */
-void h5file::extend_data(const char *dataname, int rank, const int *dims)
-{
-#ifdef HAVE_HDF5
-  extending_s *cur = get_extending(dataname);
-  CHECK(cur, "extend_data can only be called on extensible data");
-
-  hid_t file_id = HID(get_id()), data_id;
-  if (is_cur(dataname))
-    data_id = HID(cur_id);
-  else {
-    data_id = H5Dopen(file_id, dataname);
-    set_cur(dataname, &data_id);
-  }
-  hid_t space_id = H5Dget_space(data_id);
-  
-  CHECK(rank + 1 == H5Sget_simple_extent_ndims(space_id),
-	"file data is inconsistent rank for subsequent extend_data");
-  hsize_t *dims_copy = new hsize_t[rank + 1];
-  hsize_t *maxdims = new hsize_t[rank + 1];
-  H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
-  CHECK(maxdims[rank] == H5S_UNLIMITED,
-	"file data is missing unlimited dimension for extend_data");
-  delete[] maxdims;
-  for (int i = 0; i < rank; ++i)
-    CHECK(dims[i] == (int) dims_copy[i],
-	  "file data is inconsistent size for subsequent extend_data");
-  
-  H5Sclose(space_id);
-  
-  // Allocate more space along unlimited direction
-  cur->dindex++;
-  dims_copy[rank] = cur->dindex + 1;
-  H5Dextend(data_id, dims_copy);
-
-  delete[] dims_copy;
-
-#else
-  abort("not compiled with HDF5, required for HDF5 output");
-#endif
-}
-
-/* If append_data is true, dataname is the current dataset, and is
-   extensible, then as extend_data; otherwise as create_data. */
-void h5file::create_or_extend_data(const char *dataname, int rank,
-				   const int *dims,
-				   bool append_data, bool single_precision)
-{
-  if (get_extending(dataname))
-    extend_data(dataname, rank, dims);
-  else
-    create_data(dataname, rank, dims, append_data, single_precision);
-}
-
-/*****************************************************************************/
-
-/* Write a chunk of data to dataset <dataname> in HDF5 file.
-   The dataset has dimension dims[rank], and we are
-   writing a chunk stored at <data> (row-major order) of size
-   chunk_dims[rank], starting at chunk_start[rank].
-
-   You *must* have already called create_data for the same dimensions
-   (and extend_data, if necessary).
-
-   In the special case of rank == 0 (writing a single datum), chunk_dims[0]
-   should still be initialized to 1 (if the given process is writing data)
-   or 0 (if it is not).
-   
-   This function does *not* need to be called on all CPUs (e.g. those
-   that have no data can be skipped).
-*/
-void h5file::write_chunk(int rank,
-			 const int *chunk_start, const int *chunk_dims,
-			 realnum *data)
-{
-#ifdef HAVE_HDF5
-  int i;
-  bool do_write = true;
-  hid_t space_id, mem_space_id, data_id = HID(cur_id);
-  int rank1;
-  extending_s *cur = get_extending(cur_dataname);
-  bool append_data = cur != NULL;
-  int dindex = cur ? cur->dindex : 0;
-  
-  CHECK(data_id >= 0, "create_data must be called before write_chunk");
-
-  CHECK(rank >= 0, "negative rank");
-  CHECK(rank > 0 || chunk_dims[0] == 0 || chunk_dims[0] == 1,
-	"invalid chunk_dims[0] for rank 0");
-  
-  // stupid HDF5 has problems with rank 0
-  rank1 = (rank == 0 && !append_data) ? 1 : rank;
-  
-  space_id = H5Dget_space(data_id);
-
-  /*******************************************************************/
-  /* Before we can write the data to the data set, we must define
-     the dimensions and "selections" of the arrays to be read & written: */
-  
-  start_t *start = new start_t[rank1 + append_data];
-  hsize_t *count = new hsize_t[rank1 + append_data];
-  
-  int count_prod = 1;
-  for (i = 0; i < rank; ++i) {
-    start[i] = chunk_start[i];
-    count[i] = chunk_dims[i];
-    count_prod *= count[i];
-  }
-  if (!rank) {
-    start[0] = 0;
-    count[0] = chunk_dims[0]; // see comment at top
-    count_prod *= count[0];
-  }
-  if (append_data) {
-    start[rank1] = dindex;
-    count[rank1] = 1;
-  }
-  
-  if (count_prod > 0) {
-    H5Sselect_hyperslab(space_id, H5S_SELECT_SET,
-			start, NULL, count, NULL);
-    mem_space_id = H5Screate_simple(!rank1 ? 1 : rank1, count, NULL);
-    H5Sselect_all(mem_space_id);
-  }
-  else { /* this can happen on leftover processes in MPI */
-    H5Sselect_none(space_id);
-    mem_space_id = H5Scopy(space_id); /* can't create an empty space */
-    H5Sselect_none(mem_space_id);
-    do_write = false; /* HDF5 complains about empty dataspaces */
-  }
-  
-  delete[] start;
-  delete[] count;
-  
-  /*******************************************************************/
-  /* Write the data, then free all the stuff we've allocated. */
-  
-  if (do_write)
-    H5Dwrite(data_id,
-	     REALNUM_H5T, mem_space_id, space_id, H5P_DEFAULT, 
-	     (void *) data);
-  
-  H5Sclose(mem_space_id);
-  H5Sclose(space_id);
-#else
-  abort("not compiled with HDF5, required for HDF5 output");
-#endif
-}
-
-// collective call after completing all write_chunk calls
-void h5file::done_writing_chunks() {
-  /* hackery: in order to not deadlock when writing extensible datasets
-     with a non-parallel version of HDF5, we need to close the file
-     and release the lock after writing extensible chunks  ...here,
-     I'm assuming(?) that non-extensible datasets will use different
-     files, etcetera, for different timesteps.  All of this hackery
-     goes away if we just use an MPI-compiled version of HDF5. */
-  if (parallel && cur_dataname && get_extending(cur_dataname))
-    prevent_deadlock(); // closes id
-}
-
-void h5file::write(const char *dataname, int rank, const int *dims,
-		   realnum *data, bool single_precision)
-{
-  if (parallel || am_master()) {
-    int *start = new int[rank + 1];
-    for (int i = 0; i < rank; i++) start[i] = 0;
-    create_data(dataname, rank, dims, false, single_precision);
-    if (am_master())
-      write_chunk(rank, start, dims, data);
-    done_writing_chunks();
-    unset_cur();
-    delete[] start;
-  }
-}
-
-void h5file::write(const char *dataname, const char *data)
-{
-#ifdef HAVE_HDF5
-  if (IF_EXCLUSIVE(am_master(), parallel || am_master())) {
-    hid_t file_id = HID(get_id()), type_id, data_id, space_id;
-    
-    CHECK(file_id >= 0, "error opening HDF5 output file");     
-    
-    remove_data(dataname); // HDF5 gives error if we H5Dcreate existing dataset
-    
-    type_id = H5Tcopy(H5T_C_S1);;
-    H5Tset_size(type_id, strlen(data) + 1);
-    space_id = H5Screate(H5S_SCALAR);
-    
-    data_id = H5Dcreate(file_id, dataname, type_id, space_id, H5P_DEFAULT);
-    if (am_master())
-      H5Dwrite(data_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
-    
-    H5Sclose(space_id);
-    H5Tclose(type_id);
-    H5Dclose(data_id);
-  }
-#else
-  abort("not compiled with HDF5, required for HDF5 output");
-#endif
-}
-
-/*****************************************************************************/
-
-/* Inverse of write_chunk, above.  The caller must first get the 
-   total dataset's rank and dims first by calling read_size, above,
-   (which also opens the dataset for reading). */
-void h5file::read_chunk(int rank,
-			const int *chunk_start, const int *chunk_dims,
-			realnum *data)
-
-{
-#ifdef HAVE_HDF5
-  bool do_read = true;
-  int rank1;
-  hid_t space_id, mem_space_id, data_id = HID(cur_id);
-  
-  CHECK(data_id >= 0, "read_size must be called before read_chunk");
-
-  CHECK(rank >= 0, "negative rank");
-  CHECK(rank > 0 || chunk_dims[0] == 0 || chunk_dims[0] == 1,
-	"invalid chunk_dims[0] for rank 0");
-  
-  // stupid HDF5 has problems with rank 0
-  rank1 = rank == 0 ? 1 : rank;
-  
-  space_id = H5Dget_space(data_id);
-  
-  /*******************************************************************/
-  /* Before we can read the data from the data set, we must define
-     the dimensions and "selections" of the arrays to be read & written: */
-  
-  start_t *start = new start_t[rank1];
-  hsize_t *count = new hsize_t[rank1];
-  
-  int count_prod = 1;
-  for (int i = 0; i < rank; ++i) {
-    start[i] = chunk_start[i];
-    count[i] = chunk_dims[i];
-    count_prod *= count[i];
-  }
-  if (!rank) {
-    start[0] = 0;
-    count[0] = chunk_dims[0]; // see comment at top
-    count_prod *= count[0];
-  }
-  
-  if (count_prod > 0) {
-    H5Sselect_hyperslab(space_id, H5S_SELECT_SET,
-			start, NULL, count, NULL);
-    mem_space_id = H5Screate_simple(rank1, count, NULL);
-    H5Sselect_all(mem_space_id);
-  }
-  else { /* this can happen on leftover processes in MPI */
-    H5Sselect_none(space_id);
-    mem_space_id = H5Scopy(space_id); /* can't create an empty space */
-    H5Sselect_none(mem_space_id);
-    do_read = false; /* HDF5 complains about empty dataspaces */
-  }
-  
-  delete[] count;
-  delete[] start;
-  
-  /*******************************************************************/
-  /* Read the data, then free all the stuff we've allocated. */
-  
-  if (do_read)
-    H5Dread(data_id, REALNUM_H5T, mem_space_id, space_id, H5P_DEFAULT,
-	    (void *) data);
-  
-  H5Sclose(mem_space_id);
-  H5Sclose(space_id);
-#else
-  abort("not compiled with HDF5, required for HDF5 input");
-#endif
-}
-
-void h5file::open_data( const char * dataname )
-{
-#ifdef HAVE_HDF5
-
-	hid_t file_id = HID( get_id( ) );
-	hid_t data_id;
-	data_id = H5Dopen( file_id, dataname );
-	set_cur( dataname, &data_id );
-
-#else
-	abort("not compiled with HDF5, required for HDF5 input");
-#endif
-}
-
-void h5file::close_data( )
-{
-#ifdef HAVE_HDF5
-
-	unset_cur();
-
-#else
-	abort("not compiled with HDF5, required for HDF5 input");
-#endif
-}
-
-} // namespace meep
+/* Copyright (C) 2005-2012 Massachusetts Institute of Technology
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <algorithm>
+
+#include "meep.hpp"
+
+#define CHECK(condition, message) do { \
+     if (!(condition))  { \
+          abort("error on line %d of " __FILE__ ": " \
+                  message "\n", __LINE__); \
+     } \
+} while (0)
+
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#ifdef HAVE_HDF5
+
+/* don't use new HDF5 1.8 API (which isn't even fully documented yet, grrr) */
+#  define H5_USE_16_API 1
+
+#  include <hdf5.h>
+
+/* HDF5 changed this datatype in their interfaces starting in version 1.6.4 */
+#  if H5_VERS_MAJOR > 1 \
+   || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR > 6) \
+   || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR == 6 && H5_VERS_RELEASE > 3)
+     typedef hsize_t start_t;
+#  else
+     typedef hssize_t start_t;
+#  endif
+
+/* H5Dset_extent, which can also shrink a dataset, is new in 1.8 */
+#  if H5_VERS_MAJOR > 1 || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR >= 8)
+#    define HAVE_H5DSET_EXTENT 1
+#  endif
+
+#else
+typedef int hid_t;
+#endif
+
+
+#define HID(x) (*((hid_t *) (x)))
+
+/*****************************************************************************/
+/* If we have the H5Pset_fapl_mpio function (which is available if HDF5 was
+   compiled for MPI), then we can perform collective file i/o operations
+   (e.g. all processes call H5Fcreate at the same time to create one file).
+
+   If we don't, however, then we deal with it by having one process
+   work with the file at a time: "exclusive" access.  The following
+   macro helps us select different bits of code depending upon whether
+   this is the case. */
+
+#ifdef HAVE_H5PSET_MPI /* old name for this routine */
+#  define H5Pset_fapl_mpio H5Pset_mpi
+#  ifndef HAVE_H5PSET_FAPL_MPIO
+#    define HAVE_H5PSET_FAPL_MPIO 1
+#  endif
+#endif
+
+#if defined(HAVE_H5PSET_FAPL_MPIO) || !defined(HAVE_MPI)
+#  define IF_EXCLUSIVE(yes,no) no
+#else
+#  define IF_EXCLUSIVE(yes,no) yes
+static int h5io_critical_section_tag = 0;
+#endif
+
+/*****************************************************************************/
+/* Normally, HDF5 prints out all sorts of error messages, e.g. if a dataset
+   can't be found, in addition to returning an error code.  The following
+   macro can be wrapped around code to temporarily suppress error messages. */
+
+#define SUPPRESS_HDF5_ERRORS(statements) { \
+     H5E_auto_t xxxxx_err_func; \
+     void *xxxxx_err_func_data; \
+     H5Eget_auto(&xxxxx_err_func, &xxxxx_err_func_data); \
+     H5Eset_auto(NULL, NULL); \
+     { statements; } \
+     H5Eset_auto(xxxxx_err_func, xxxxx_err_func_data); \
+}
+
+/*****************************************************************************/
+
+#ifdef HAVE_HDF5
+static bool dataset_exists(hid_t id, const char *name)
+{
+     hid_t data_id;
+     SUPPRESS_HDF5_ERRORS(data_id = H5Dopen(id, name));
+     if (data_id >= 0)
+          H5Dclose(data_id);
+     return (data_id >= 0);
+}
+#endif
+
+/*****************************************************************************/
+
+namespace meep {
+
+// lazy file creation & locking
+void *h5file::get_id() {
+  if (HID(id) < 0) {
+    if (parallel)
+      all_wait();
+
+#ifdef HAVE_HDF5
+    hid_t access_props = H5Pcreate (H5P_FILE_ACCESS);
+#  ifdef HAVE_MPI
+#    ifdef HAVE_H5PSET_FAPL_MPIO
+    if (parallel)
+      H5Pset_fapl_mpio(access_props, MPI_COMM_WORLD, MPI_INFO_NULL);
+#    else
+    if (parallel)
+      begin_critical_section(h5io_critical_section_tag);
+#    endif
+#  endif
+
+    if (mode != WRITE || IF_EXCLUSIVE(parallel && !am_master(), 0))
+      HID(id) = H5Fopen(filename,
+			mode == READONLY ? H5F_ACC_RDONLY : H5F_ACC_RDWR,
+			access_props);
+    else
+      HID(id) = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, access_props);
+    
+    H5Pclose(access_props);
+#endif
+  }
+  return id;
+}
+
+// hackery: in some circumstances, for the exclusive-access mode
+// we must close the id (i.e. the file) in order to prevent deadlock.
+void h5file::prevent_deadlock() {
+  sync();
+  IF_EXCLUSIVE(if (parallel) close_id(), (void) 0);
+}
+
+/* Writes the buffered steps of an appended dataset and cuts its
+   pre-extended tail, so that the file holds exactly the steps written so
+   far; appending can go on afterwards.  Collective like extend_data. */
+void h5file::trim_extending(extending_s *cur) {
+  if (append_depth > 1 && cur->dindex >= cur->base)
+    flush_extending(cur, cur->dindex + 1);
+#if defined(HAVE_HDF5) && defined(HAVE_H5DSET_EXTENT)
+  if (HID(cur->data_id) >= 0 && cur->allocated > cur->dindex + 1) {
+    int rank = H5Sget_simple_extent_ndims(HID(cur->space_id));
+    hsize_t *dims = new hsize_t[rank];
+    H5Sget_simple_extent_dims(HID(cur->space_id), dims, NULL);
+    dims[rank - 1] = cur->allocated = cur->dindex + 1;
+    H5Dset_extent(HID(cur->data_id), dims);
+    H5Sclose(HID(cur->space_id));
+    HID(cur->space_id) = H5Dget_space(HID(cur->data_id));
+    delete[] dims;
+  }
+#endif
+}
+
+void h5file::close_id() {
+  for (extending_s *cur = extending; cur; cur = cur->next)
+    trim_extending(cur);
+  for (extending_s *cur = extending; cur; cur = cur->next)
+    release_extending(cur);
+  unset_cur();
+  if (HID(id) >= 0)
+    if (mode == WRITE) mode = READWRITE; // don't re-create on re-open
+#ifdef HAVE_HDF5
+  if (HID(id) >= 0) {
+    H5Fclose(HID(id));
+    IF_EXCLUSIVE(if (parallel)
+		 end_critical_section(h5io_critical_section_tag++),
+		 (void) 0);
+  }
+#endif
+  HID(id) = -1;
+}
+
+/* note: if parallel is true, then *all* processes must call this,
+   and all processes will use I/O. */
+h5file::h5file(const char *filename_, access_mode m, bool parallel_) {
+  cur_dataname = NULL;
+  cur_append_data = false;
+  id = (void*) malloc(sizeof(hid_t));
+  cur_id = (void*) malloc(sizeof(hid_t));
+  HID(id) = -1;
+  HID(cur_id) = -1;
+  extending = 0;
+  filename = new char[strlen(filename_) + 1];
+  strcpy(filename, filename_);
+  mode = m;
+  parallel = parallel_;
+  twin = NULL;
+  is_twin = false;
+  extend_block = 1;
+  append_depth = 1;
+}
+
+h5file::~h5file() {
+  sync(); // waits for the queued work and takes the file back from the twin
+  close_id();
+  if (cur_dataname) free(cur_dataname); // allocated with realloc
+  for (h5file::extending_s *cur = extending; cur; ) {
+    h5file::extending_s *next = cur->next;
+    delete_extending(cur);
+    cur = next;
+  }
+  delete[] filename;
+  free(cur_id);
+  free(id);
+}
+
+bool h5file::ok() {
+  sync();
+  return (HID(get_id()) >= 0);
+}
+
+void h5file::remove() {
+  sync();
+  close_id();
+  if (mode == READWRITE) mode = WRITE; // now need to re-create file
+  for (h5file::extending_s *cur = extending; cur; ) {
+    h5file::extending_s *next = cur->next;
+    delete_extending(cur);
+    cur = next;
+  }
+  extending = 0;
+  
+  IF_EXCLUSIVE(if (parallel) all_wait(), (void) 0);
+  if (am_master() && std::remove(filename))
+    abort("error removing file %s", filename);
+}
+
+h5file::extending_s *h5file::get_extending(const char *dataname) const {
+  for (extending_s *cur = extending; cur; cur = cur->next)
+    if (!strcmp(dataname, cur->dataname))
+      return cur;
+  return NULL;
+}
+
+/* The extensible datasets keep their dataset and dataspace ids open from
+   create_data until the file is closed, so that appending a time step
+   costs no H5Dopen / H5Dget_space; set_cur and unset_cur leave them be. */
+h5file::extending_s *h5file::new_extending(const char *dataname) {
+  extending_s *cur = new extending_s;
+  cur->dataname = new char[strlen(dataname) + 1];
+  strcpy(cur->dataname, dataname);
+  cur->dindex = 0;
+  cur->allocated = 1;
+  cur->data_id = (void*) malloc(sizeof(hid_t));
+  cur->space_id = (void*) malloc(sizeof(hid_t));
+  HID(cur->data_id) = -1;
+  HID(cur->space_id) = -1;
+  cur->base = 0;
+  cur->bufs = NULL;
+  cur->next = extending;
+  extending = cur;
+  return cur;
+}
+
+/* With set_append_buffer( depth ), write_chunk keeps each chunk of an
+   appended dataset for depth time steps in memory, the time index running
+   fastest as in the file, and flush_extending writes all steps of a chunk
+   with one hyperslab.  Every step must write the same chunks. */
+struct h5file::append_buf {
+  int rank;
+  int *start, *dims;
+  size_t n;
+  int depth;
+  realnum *data; // [ n ][ depth ]
+  int lo, hi; // slots filled since the last flush
+  append_buf *next;
+  ~append_buf() { delete[] start; delete[] dims; delete[] data; delete next; }
+};
+
+// frees an entry already unlinked from the list (or the whole list)
+void h5file::delete_extending(extending_s *cur) {
+  release_extending(cur);
+  delete cur->bufs;
+  free(cur->data_id);
+  free(cur->space_id);
+  delete[] cur->dataname;
+  delete cur;
+}
+
+void h5file::release_extending(extending_s *cur) {
+#ifdef HAVE_HDF5
+  if (HID(cur->space_id) >= 0)
+    H5Sclose(HID(cur->space_id));
+  if (HID(cur->data_id) >= 0) {
+    if (HID(cur_id) == HID(cur->data_id)) {
+      HID(cur_id) = -1;
+      if (cur_dataname) cur_dataname[0] = 0;
+    }
+    H5Dclose(HID(cur->data_id));
+  }
+#endif
+  HID(cur->space_id) = -1;
+  HID(cur->data_id) = -1;
+}
+
+bool h5file::is_cached(void *data_id) const {
+  if (HID(data_id) < 0) return false;
+  for (extending_s *cur = extending; cur; cur = cur->next)
+    if (HID(cur->data_id) == HID(data_id))
+      return true;
+  return false;
+}
+
+/* Appended datasets grow by n steps at a time instead of one, which saves
+   the H5Dextend (and the chunk index update) of the other n-1 steps; the
+   unused tail is cut off when the file is closed.  Only effective with
+   HDF5 >= 1.8 and not for parallel files in exclusive mode, whose file is
+   closed after every step anyway. */
+void h5file::set_extend_block(int n) {
+  sync();
+  extend_block = n > 1 ? n : 1;
+#ifndef HAVE_H5DSET_EXTENT
+  extend_block = 1;
+#endif
+  IF_EXCLUSIVE(if (parallel) extend_block = 1, (void) 0);
+}
+
+bool h5file::is_cur(const char *dataname) {
+  return cur_dataname && !strcmp(cur_dataname, dataname);
+}
+
+void h5file::unset_cur() {
+#ifdef HAVE_HDF5
+  if (HID(cur_id) >= 0 && !is_cached(cur_id))
+    H5Dclose(HID(cur_id));
+#endif
+  HID(cur_id) = -1;
+  if (cur_dataname)
+    cur_dataname[0] = 0;
+}
+
+void h5file::set_cur(const char *dataname, void *data_id) {
+#ifdef HAVE_HDF5
+  if (HID(cur_id) >= 0 && HID(cur_id) != HID(data_id) && !is_cached(cur_id))
+    H5Dclose(HID(cur_id));
+#endif
+  HID(cur_id) = HID(data_id);
+  if (!is_cur(dataname)) {
+    if (!cur_dataname || strlen(dataname) > strlen(cur_dataname))
+      cur_dataname = (char *) realloc(cur_dataname, strlen(dataname) + 1);
+    strcpy(cur_dataname, dataname);
+  }
+}
+
+void h5file::read_size(const char *dataname, int *rank, int *dims, int maxrank)
+{
+  sync();
+  if (extending_s *cur = get_extending(dataname)) // written steps only
+    trim_extending(cur);
+#ifdef HAVE_HDF5
+  if (parallel || am_master()) {
+    hid_t file_id = HID(get_id()), space_id, data_id;
+    
+    CHECK(file_id >= 0, "error opening HDF5 input file");
+    
+    if (is_cur(dataname))
+      data_id = HID(cur_id);
+    else {
+      CHECK(dataset_exists(file_id, dataname),
+	    "missing dataset in HDF5 file");
+      data_id = H5Dopen(file_id, dataname);
+      set_cur(dataname, &data_id);
+    }
+    space_id = H5Dget_space(data_id);
+    
+    *rank = H5Sget_simple_extent_ndims(space_id);
+    CHECK(*rank <= maxrank, "input array rank is too big");
+    
+    hsize_t *dims_copy = new hsize_t[*rank];
+    hsize_t *maxdims = new hsize_t[*rank];
+    H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
+    for (int i = 0; i < *rank; ++i) dims[i] = dims_copy[i];
+    delete[] maxdims;
+    delete[] dims_copy;
+    H5Sclose(space_id);
+  }
+
+  if (!parallel) {
+    *rank = broadcast(0, *rank);
+    broadcast(0, dims, *rank);
+    
+    if (*rank == 1 && dims[0] == 1)
+      *rank = 0;
+  }
+#endif
+}
+
+#ifdef HAVE_HDF5
+  /* check if the given name is a dataset in group_id, and if so set d
+     to point to a char** with a copy of name. */
+
+  static herr_t find_dataset(hid_t group_id, 
+			     const char *name, void *d)
+  {
+    char **dname = (char **) d;
+    H5G_stat_t info;
+
+    H5Gget_objinfo(group_id, name, 1, &info);
+    if (info.type == H5G_DATASET) {
+      *dname = new char[strlen(name) + 1];
+      strcpy(*dname, name);
+      return 1;
+    }
+    return 0;
+  }
+
+#endif
+
+#define REALNUM_H5T (sizeof(realnum) == sizeof(double) ? H5T_NATIVE_DOUBLE : H5T_NATIVE_FLOAT)
+
+realnum *h5file::read(const char *dataname,
+		     int *rank, int *dims, int maxrank)
+{
+  sync();
+  for (extending_s *cur = extending; cur; cur = cur->next) // written steps only
+    if (!dataname || !strcmp(dataname, cur->dataname))
+      trim_extending(cur);
+#ifdef HAVE_HDF5
+  realnum *data = 0;
+  if (parallel || am_master()) {
+    int i, N;
+    hid_t file_id = HID(get_id()), space_id, data_id;
+    
+    CHECK(file_id >= 0, "error opening HDF5 input file");
+
+    bool close_data_id = true;
+    if (dataname) {
+      if (is_cur(dataname)) {
+	data_id = HID(cur_id);
+	close_data_id = false;
+      }
+      else {
+	CHECK(dataset_exists(file_id, dataname),
+	      "missing dataset in HDF5 file");
+	data_id = H5Dopen(file_id, dataname);
+      }
+    }
+    else { // find first dataset in file
+      char *dname = 0;
+      CHECK(H5Giterate(file_id, "/",NULL, find_dataset,&dname) >= 0 && dname,
+	    "cannot find dataset in HDF5 file");
+      if (is_cur(dname)) {
+	data_id = HID(cur_id);
+	close_data_id = false;
+      }
+      else {
+	data_id = H5Dopen(file_id, dname);
+      }
+      delete[] dname;
+    }
+    space_id = H5Dget_space(data_id);
+    
+    *rank = H5Sget_simple_extent_ndims(space_id);
+    CHECK(*rank <= maxrank, "input array rank is too big");
+    
+    hsize_t *dims_copy = new hsize_t[*rank];
+    hsize_t *maxdims = new hsize_t[*rank];
+    H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
+    delete[] maxdims;
+    for (N = 1, i = 0; i < *rank; ++i)
+      N *= (dims[i] = dims_copy[i]);
+    delete[] dims_copy;
+    H5Sclose(space_id);
+    
+    data = new realnum[N];
+    H5Dread(data_id, REALNUM_H5T, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+	    (void *) data);
+    
+    if (close_data_id)
+      H5Dclose(data_id);
+  }
+  
+  if (!parallel) {
+    *rank = broadcast(0, *rank);
+    broadcast(0, dims, *rank);
+    int N = 1;
+    for (int i = 0; i < *rank; ++i)
+      N *= dims[i];
+    if (!am_master())
+      data = new realnum[N];
+    broadcast(0, data, N);
+  }
+
+  if (*rank == 1 && dims[0] == 1)
+    *rank = 0;
+  
+  return data;
+#else
+  return NULL;
+#endif
+}
+
+char *h5file::read(const char *dataname)
+{
+  sync();
+#ifdef HAVE_HDF5
+  char *data = 0;
+  int len = 0;
+  if (parallel || am_master()) {
+    hid_t file_id = HID(get_id()), space_id, data_id, type_id;
+    
+    CHECK(file_id >= 0, "error opening HDF5 input file");
+    
+    if (is_cur(dataname))
+      unset_cur();
+
+    CHECK(dataset_exists(file_id, dataname),
+	  "missing dataset in HDF5 file");
+    
+    data_id = H5Dopen(file_id, dataname);
+    space_id = H5Dget_space(data_id);
+    type_id = H5Dget_type(data_id);
+    
+    CHECK(H5Sget_simple_extent_npoints(space_id) == 1,
+	  "expected single string in HDF5 file, but didn't get one");
+    
+    len = H5Tget_size(type_id);
+    H5Tclose(type_id);
+    type_id = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type_id, len);
+    
+    data = new char[len];
+    H5Dread(data_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+	    (void *) data);
+    
+    H5Tclose(type_id);
+    H5Sclose(space_id);	  
+    H5Dclose(data_id);
+  }
+  
+  if (!parallel) {
+    len = broadcast(0, len);
+    if (!am_master())
+      data = new char[len];
+    broadcast(0, data, len);
+  }
+  
+  return data;
+#else
+  return NULL;
+#endif
+}
+
+/*****************************************************************************/
+
+/* Delete a dataset, if it exists.  In parallel mode, should be called
+   by all processors. */
+void h5file::remove_data(const char *dataname)
+{
+  sync();
+#ifdef HAVE_HDF5
+  hid_t file_id = HID(get_id());
+
+  if (is_cur(dataname))
+    unset_cur();
+
+  if (get_extending(dataname)) { // delete dataname from extending list
+    extending_s *prev = 0, *cur = extending;
+    for (; cur && strcmp(cur->dataname, dataname); cur = (prev = cur)->next) ;
+    if (!cur) abort("bug in remove_data: inconsistent get_extending");
+    if (prev)
+      prev->next = cur->next;
+    else
+      extending = cur->next;
+    delete_extending(cur);
+  }
+
+  if (dataset_exists(file_id, dataname)) {
+    /* this is hackish ...need to pester HDF5 developers to make
+       H5Gunlink a collective operation for parallel mode */
+    if (!parallel || am_master()) {
+      H5Gunlink(file_id, dataname);  /* delete it */
+      H5Fflush(file_id, H5F_SCOPE_GLOBAL);
+    }
+    IF_EXCLUSIVE((void) 0, if (parallel) all_wait());
+  }
+#endif
+}
+
+/* Create a dataset, for writing chunks etc.  Note that, in parallel mode,
+   this should be called by *all* processors, even those not writing any
+   data.  deflate > 0 (gzip level, up to 9) and shuffle add the HDF5
+   compression filters; they need a chunked layout, so a dataset that is
+   not appended to is stored in chunks of at most 2^18 elements. */
+void h5file::create_data(const char *dataname, int rank, const int *dims,
+			 bool append_data, bool single_precision,
+			 int deflate, bool shuffle)
+{
+  if (async_here()) {
+    queue_job(H5JOB_CREATE, dataname, rank, dims, NULL, NULL, 0,
+	      append_data, single_precision, deflate, shuffle);
+    return;
+  }
+  sync();
+#ifdef HAVE_HDF5
+  int i;
+  hid_t file_id = HID(get_id()), space_id, data_id;
+  int rank1;
+
+  CHECK(rank >= 0, "negative rank");
+  
+  // stupid HDF5 has problems with rank 0
+  rank1 = (rank == 0 && !append_data) ? 1 : rank;
+  
+  CHECK(file_id >= 0, "error opening HDF5 output file");
+
+#ifdef HAVE_H5PSET_FAPL_MPIO
+  // filtered datasets cannot be written independently with MPI-IO
+  if (parallel) {
+    deflate = 0;
+    shuffle = false;
+  }
+#endif
+
+  unset_cur();
+  remove_data(dataname); // HDF5 gives error if we H5Dcreate existing dataset
+  
+  if (IF_EXCLUSIVE(!parallel || am_master(), 1)) {
+    hsize_t *dims_copy = new hsize_t[rank1 + append_data];
+    hsize_t *maxdims = new hsize_t[rank1 + append_data];
+    hsize_t N = 1;
+    for (i = 0; i < rank; ++i)
+      N *= (maxdims[i] = dims_copy[i] = dims[i]);
+    if (!rank)
+      maxdims[0] = dims_copy[0] = 1;
+    if (append_data) {
+      dims_copy[rank1] = 1;
+      maxdims[rank1] = H5S_UNLIMITED;
+    }
+    space_id = H5Screate_simple(rank1 + append_data, dims_copy, maxdims);
+    delete[] maxdims;
+    
+    /* For unlimited datasets, we need to specify the size of the
+       "chunks" in which the file data is allocated.  */
+    hid_t prop_id = H5Pcreate(H5P_DATASET_CREATE);
+    if (append_data) {
+      const int blocksize = 128;
+      // make a chunk at least blocksize elements for efficiency
+      dims_copy[rank1] = (blocksize + (N - 1)) / N;
+      H5Pset_chunk(prop_id, rank1 + 1, dims_copy);
+      dims_copy[rank1] = 1;
+    }
+    else if ((deflate > 0 || shuffle) && N > 0) {
+      const hsize_t max_chunk = 262144;
+      hsize_t *chunk_dims = new hsize_t[rank1];
+      hsize_t M = 1;
+      for (i = 0; i < rank1; ++i)
+	M *= (chunk_dims[i] = dims_copy[i]);
+      // halve the leading dimensions first, keeping rows contiguous
+      for (i = 0; i < rank1 && M > max_chunk; ++i)
+	while (chunk_dims[i] > 1 && M > max_chunk) {
+	  M /= chunk_dims[i];
+	  chunk_dims[i] = (chunk_dims[i] + 1) / 2;
+	  M *= chunk_dims[i];
+	}
+      H5Pset_chunk(prop_id, rank1, chunk_dims);
+      delete[] chunk_dims;
+    }
+    if (append_data || N > 0) {
+      if (shuffle) H5Pset_shuffle(prop_id); // must precede deflate
+      if (deflate > 0) H5Pset_deflate(prop_id, deflate > 9 ? 9 : deflate);
+    }
+    
+    delete[] dims_copy;
+    
+    hid_t type_id = single_precision ? H5T_NATIVE_FLOAT : REALNUM_H5T;
+    
+    data_id = H5Dcreate(file_id, dataname, type_id, space_id, prop_id);
+    if (data_id < 0) abort("Error creating dataset");
+    
+    H5Pclose(prop_id);
+  }
+  else {
+    data_id = H5Dopen(file_id, dataname);
+    CHECK(data_id >= 0, "missing dataset for subsequent processor");
+    space_id = H5Dget_space(data_id);
+  
+    CHECK(rank1 + append_data == H5Sget_simple_extent_ndims(space_id),
+	  "file data is inconsistent rank for subsequent processor");
+    
+    hsize_t *dims_copy = new hsize_t[rank1 + append_data];
+    hsize_t *maxdims = new hsize_t[rank1 + append_data];
+    H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
+    CHECK(!append_data || maxdims[rank1] == H5S_UNLIMITED,
+	  "file data is missing unlimited dimension for append_data");
+    delete[] maxdims;
+    for (i = 0; i < rank; ++i)
+      CHECK(dims[i] == (int) dims_copy[i],
+	    "file data is inconsistent size for subsequent processor");
+    if (rank < rank1)
+      CHECK(dims_copy[0] == 1, "rank-0 data is incorrect size");
+    
+    delete[] dims_copy;
+  }
+  
+  if (append_data) { // ids go to the cache
+    extending_s *cur = new_extending(dataname);
+    HID(cur->data_id) = data_id;
+    HID(cur->space_id) = space_id;
+  }
+  else
+    H5Sclose(space_id);
+  set_cur(dataname, &data_id);
+#else
+  abort("not compiled with HDF5, required for HDF5 output");
+#endif
+}
+
+/* Appended datasets are written every n steps, n slices per chunk at once,
+   which for small probes saves nearly all of the per step HDF5 overhead.
+   The buffered steps are written when the buffer is full, by
+   flush_appended and when the file is closed; reading back a dataset
+   before that misses them.  Not for parallel files in exclusive mode. */
+void h5file::set_append_buffer(int n) {
+  sync();
+  for (extending_s *cur = extending; cur; cur = cur->next) {
+    if (append_depth > 1)
+      flush_extending(cur, cur->dindex + 1);
+    cur->base = cur->dindex + 1; // steps so far are in the file
+    delete cur->bufs;
+    cur->bufs = NULL;
+  }
+  append_depth = n > 1 ? n : 1;
+  IF_EXCLUSIVE(if (parallel) append_depth = 1, (void) 0);
+}
+
+void h5file::flush_appended() {
+  sync();
+  if (append_depth > 1)
+    for (extending_s *cur = extending; cur; cur = cur->next)
+      flush_extending(cur, cur->dindex + 1);
+}
+
+/* Writes the buffered steps base .. upto-1 of cur, extending the dataset as
+   needed; collective like extend_data. */
+void h5file::flush_extending(extending_s *cur, int upto) {
+#ifdef HAVE_HDF5
+  if (upto <= cur->base) return;
+  hid_t file_id = HID(get_id());
+  if (HID(cur->data_id) < 0) {
+    HID(cur->data_id) = H5Dopen(file_id, cur->dataname);
+    HID(cur->space_id) = H5Dget_space(HID(cur->data_id));
+  }
+  hid_t data_id = HID(cur->data_id);
+
+  int rank1 = H5Sget_simple_extent_ndims(HID(cur->space_id));
+  hsize_t *dims = new hsize_t[rank1];
+  H5Sget_simple_extent_dims(HID(cur->space_id), dims, NULL);
+  if ((int) dims[rank1 - 1] > cur->allocated)
+    cur->allocated = dims[rank1 - 1];
+  if (upto > cur->allocated) {
+    dims[rank1 - 1] = cur->allocated = upto - 1 + extend_block;
+    H5Dextend(data_id, dims);
+    H5Sclose(HID(cur->space_id));
+    HID(cur->space_id) = H5Dget_space(data_id);
+  }
+  delete[] dims;
+  hid_t space_id = HID(cur->space_id);
+
+  for (append_buf *b = cur->bufs; b; b = b->next) {
+    if (b->lo > b->hi) continue;
+    start_t *start = new start_t[b->rank + 1];
+    hsize_t *count = new hsize_t[b->rank + 1];
+    hsize_t *mem_dims = new hsize_t[b->rank + 1];
+    for (int i = 0; i < b->rank; ++i) {
+      start[i] = b->start[i];
+      count[i] = mem_dims[i] = b->dims[i];
+    }
+    start[b->rank] = cur->base + b->lo;
+    count[b->rank] = b->hi - b->lo + 1;
+    mem_dims[b->rank] = b->depth;
+    H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL);
+
+    hid_t mem_space_id = H5Screate_simple(b->rank + 1, mem_dims, NULL);
+    for (int i = 0; i < b->rank; ++i) start[i] = 0;
+    start[b->rank] = b->lo;
+    H5Sselect_hyperslab(mem_space_id, H5S_SELECT_SET,
+			start, NULL, count, NULL);
+    H5Dwrite(data_id, REALNUM_H5T, mem_space_id, space_id, H5P_DEFAULT,
+	     (void *) b->data);
+    H5Sclose(mem_space_id);
+
+    delete[] mem_dims;
+    delete[] count;
+    delete[] start;
+    b->lo = b->depth;
+    b->hi = -1;
+  }
+#endif
+  cur->base = upto;
+}
+
+/* Assumed data already created with append_data == true, and is
+   already open; extends it and increments cur_dindex.  Like
+   create_data, this is a collective operation and must be called from
+   all processes. */
+void h5file::extend_data(const char *dataname, int rank, const int *dims)
+{
+  if (async_here()) {
+    queue_job(H5JOB_EXTEND, dataname, rank, dims, NULL, NULL, 0);
+    return;
+  }
+  sync();
+#ifdef HAVE_HDF5
+  extending_s *cur = get_extending(dataname);
+  CHECK(cur, "extend_data can only be called on extensible data");
+
+  if (append_depth > 1) { // the file grows in flush_extending
+    cur->dindex++;
+    if (cur->dindex - cur->base >= append_depth)
+      flush_extending(cur, cur->dindex);
+    set_cur(dataname, cur->data_id);
+    return;
+  }
+
+  hid_t file_id = HID(get_id());
+  if (HID(cur->data_id) < 0) { // file was closed since the last step
+    HID(cur->data_id) = H5Dopen(file_id, dataname);
+    HID(cur->space_id) = H5Dget_space(HID(cur->data_id));
+  }
+  hid_t data_id = HID(cur->data_id), space_id = HID(cur->space_id);
+  set_cur(dataname, cur->data_id);
+  
+  CHECK(rank + 1 == H5Sget_simple_extent_ndims(space_id),
+	"file data is inconsistent rank for subsequent extend_data");
+  hsize_t *dims_copy = new hsize_t[rank + 1];
+  hsize_t *maxdims = new hsize_t[rank + 1];
+  H5Sget_simple_extent_dims(space_id, dims_copy, maxdims);
+  CHECK(maxdims[rank] == H5S_UNLIMITED,
+	"file data is missing unlimited dimension for extend_data");
+  delete[] maxdims;
+  for (int i = 0; i < rank; ++i)
+    CHECK(dims[i] == (int) dims_copy[i],
+	  "file data is inconsistent size for subsequent extend_data");
+  if ((int) dims_copy[rank] > cur->allocated) // reopened, not yet cut
+    cur->allocated = dims_copy[rank];
+  
+  // Allocate more space along unlimited direction, extend_block at a time
+  cur->dindex++;
+  if (cur->dindex >= cur->allocated) {
+    dims_copy[rank] = cur->allocated = cur->dindex + extend_block;
+    H5Dextend(data_id, dims_copy);
+    H5Sclose(space_id);
+    HID(cur->space_id) = H5Dget_space(data_id);
+  }
+
+  delete[] dims_copy;
+
+#else
+  abort("not compiled with HDF5, required for HDF5 output");
+#endif
+}
+
+/* If append_data is true, dataname is the current dataset, and is
+   extensible, then as extend_data; otherwise as create_data. */
+void h5file::create_or_extend_data(const char *dataname, int rank,
+				   const int *dims,
+				   bool append_data, bool single_precision)
+{
+  if (async_here()) { // the writer thread knows which datasets it extends
+    queue_job(H5JOB_CREATE_OR_EXTEND, dataname, rank, dims, NULL, NULL, 0,
+	      append_data, single_precision);
+    return;
+  }
+  sync();
+  if (get_extending(dataname))
+    extend_data(dataname, rank, dims);
+  else
+    create_data(dataname, rank, dims, append_data, single_precision);
+}
+
+/*****************************************************************************/
+
+/* Write a chunk of data to dataset <dataname> in HDF5 file.
+   The dataset has dimension dims[rank], and we are
+   writing a chunk stored at <data> (row-major order) of size
+   chunk_dims[rank], starting at chunk_start[rank].
+
+   You *must* have already called create_data for the same dimensions
+   (and extend_data, if necessary).
+
+   In the special case of rank == 0 (writing a single datum), chunk_dims[0]
+   should still be initialized to 1 (if the given process is writing data)
+   or 0 (if it is not).
+   
+   This function does *not* need to be called on all CPUs (e.g. those
+   that have no data can be skipped).
+*/
+void h5file::write_chunk(int rank,
+			 const int *chunk_start, const int *chunk_dims,
+			 realnum *data)
+{
+  if (async_here()) {
+    size_t n = rank ? 1 : chunk_dims[0];
+    for (int i = 0; i < rank; ++i) n *= chunk_dims[i];
+    queue_job(H5JOB_CHUNK, NULL, rank, chunk_dims, chunk_start, data, n);
+    return;
+  }
+  sync();
+  if (append_depth > 1 && cur_dataname) { // buffered appending
+    extending_s *cur = get_extending(cur_dataname);
+    int slot = cur ? cur->dindex - cur->base : -1;
+    if (slot >= 0 && slot < append_depth) {
+      size_t n = rank ? 1 : chunk_dims[0];
+      for (int i = 0; i < rank; ++i) n *= chunk_dims[i];
+      if (!n) return;
+      append_buf *b = cur->bufs;
+      for (; b; b = b->next)
+	if (b->rank == rank && b->n == n
+	    && !memcmp(b->start, chunk_start, rank * sizeof(int))
+	    && !memcmp(b->dims, chunk_dims, rank * sizeof(int)))
+	  break;
+      if (!b) {
+	b = new append_buf;
+	b->rank = rank;
+	b->start = new int[rank + 1];
+	b->dims = new int[rank + 1];
+	memcpy(b->start, chunk_start, rank * sizeof(int));
+	memcpy(b->dims, chunk_dims, rank * sizeof(int));
+	b->n = n;
+	b->depth = append_depth;
+	b->data = new realnum[n * append_depth];
+	memset(b->data, 0, n * append_depth * sizeof(realnum));
+	b->lo = append_depth;
+	b->hi = -1;
+	b->next = cur->bufs;
+	cur->bufs = b;
+      }
+      for (size_t i = 0; i < n; ++i)
+	b->data[i * b->depth + slot] = data[i];
+      if (slot < b->lo) b->lo = slot;
+      if (slot > b->hi) b->hi = slot;
+      return;
+    }
+  }
+#ifdef HAVE_HDF5
+  int i;
+  bool do_write = true;
+  hid_t space_id, mem_space_id, data_id = HID(cur_id);
+  int rank1;
+  extending_s *cur = get_extending(cur_dataname);
+  bool append_data = cur != NULL;
+  int dindex = cur ? cur->dindex : 0;
+  
+  CHECK(data_id >= 0, "create_data must be called before write_chunk");
+
+  CHECK(rank >= 0, "negative rank");
+  CHECK(rank > 0 || chunk_dims[0] == 0 || chunk_dims[0] == 1,
+	"invalid chunk_dims[0] for rank 0");
+  
+  // stupid HDF5 has problems with rank 0
+  rank1 = (rank == 0 && !append_data) ? 1 : rank;
+  
+  // the cached dataspace of appended data is reused, only reselected
+  bool cached_space = append_data && HID(cur->space_id) >= 0;
+  space_id = cached_space ? HID(cur->space_id) : H5Dget_space(data_id);
+
+  /*******************************************************************/
+  /* Before we can write the data to the data set, we must define
+     the dimensions and "selections" of the arrays to be read & written: */
+  
+  start_t *start = new start_t[rank1 + append_data];
+  hsize_t *count = new hsize_t[rank1 + append_data];
+  
+  int count_prod = 1;
+  for (i = 0; i < rank; ++i) {
+    start[i] = chunk_start[i];
+    count[i] = chunk_dims[i];
+    count_prod *= count[i];
+  }
+  if (!rank) {
+    start[0] = 0;
+    count[0] = chunk_dims[0]; // see comment at top
+    count_prod *= count[0];
+  }
+  if (append_data) {
+    start[rank1] = dindex;
+    count[rank1] = 1;
+  }
+  
+  if (count_prod > 0) {
+    H5Sselect_hyperslab(space_id, H5S_SELECT_SET,
+			start, NULL, count, NULL);
+    mem_space_id = H5Screate_simple(!rank1 ? 1 : rank1, count, NULL);
+    H5Sselect_all(mem_space_id);
+  }
+  else { /* this can happen on leftover processes in MPI */
+    H5Sselect_none(space_id);
+    mem_space_id = H5Scopy(space_id); /* can't create an empty space */
+    H5Sselect_none(mem_space_id);
+    do_write = false; /* HDF5 complains about empty dataspaces */
+  }
+  
+  delete[] start;
+  delete[] count;
+  
+  /*******************************************************************/
+  /* Write the data, then free all the stuff we've allocated. */
+  
+  if (do_write)
+    H5Dwrite(data_id,
+	     REALNUM_H5T, mem_space_id, space_id, H5P_DEFAULT, 
+	     (void *) data);
+  
+  H5Sclose(mem_space_id);
+  if (!cached_space) H5Sclose(space_id);
+#else
+  abort("not compiled with HDF5, required for HDF5 output");
+#endif
+}
+
+// collective call after completing all write_chunk calls
+void h5file::done_writing_chunks() {
+  if (async_here()) {
+    queue_job(H5JOB_DONE, NULL, 0, NULL, NULL, NULL, 0);
+    return;
+  }
+  /* hackery: in order to not deadlock when writing extensible datasets
+     with a non-parallel version of HDF5, we need to close the file
+     and release the lock after writing extensible chunks  ...here,
+     I'm assuming(?) that non-extensible datasets will use different
+     files, etcetera, for different timesteps.  All of this hackery
+     goes away if we just use an MPI-compiled version of HDF5. */
+  if (parallel && cur_dataname && get_extending(cur_dataname))
+    prevent_deadlock(); // closes id
+}
+
+void h5file::write(const char *dataname, int rank, const int *dims,
+		   realnum *data, bool single_precision,
+		   int deflate, bool shuffle)
+{
+  if (parallel || am_master()) {
+    if (async_here()) { // one job, the writer thread must not call am_master
+      size_t n = 1;
+      for (int i = 0; i < rank; ++i) n *= dims[i];
+      queue_job(H5JOB_WRITE, dataname, rank, dims, NULL,
+		am_master() ? data : NULL, am_master() ? n : 0,
+		false, single_precision, deflate, shuffle);
+      return;
+    }
+    sync();
+    int *start = new int[rank + 1];
+    for (int i = 0; i < rank; i++) start[i] = 0;
+    create_data(dataname, rank, dims, false, single_precision,
+		deflate, shuffle);
+    if (am_master())
+      write_chunk(rank, start, dims, data);
+    done_writing_chunks();
+    unset_cur();
+    delete[] start;
+  }
+}
+
+void h5file::write(const char *dataname, const char *data)
+{
+  sync();
+#ifdef HAVE_HDF5
+  if (IF_EXCLUSIVE(am_master(), parallel || am_master())) {
+    hid_t file_id = HID(get_id()), type_id, data_id, space_id;
+    
+    CHECK(file_id >= 0, "error opening HDF5 output file");     
+    
+    remove_data(dataname); // HDF5 gives error if we H5Dcreate existing dataset
+    
+    type_id = H5Tcopy(H5T_C_S1);;
+    H5Tset_size(type_id, strlen(data) + 1);
+    space_id = H5Screate(H5S_SCALAR);
+    
+    data_id = H5Dcreate(file_id, dataname, type_id, space_id, H5P_DEFAULT);
+    if (am_master())
+      H5Dwrite(data_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    
+    H5Sclose(space_id);
+    H5Tclose(type_id);
+    H5Dclose(data_id);
+  }
+#else
+  abort("not compiled with HDF5, required for HDF5 output");
+#endif
+}
+
+/*****************************************************************************/
+
+/* Inverse of write_chunk, above.  The caller must first get the 
+   total dataset's rank and dims first by calling read_size, above,
+   (which also opens the dataset for reading). */
+void h5file::read_chunk(int rank,
+			const int *chunk_start, const int *chunk_dims,
+			realnum *data)
+
+{
+  sync();
+#ifdef HAVE_HDF5
+  bool do_read = true;
+  int rank1;
+  hid_t space_id, mem_space_id, data_id = HID(cur_id);
+  
+  CHECK(data_id >= 0, "read_size must be called before read_chunk");
+
+  CHECK(rank >= 0, "negative rank");
+  CHECK(rank > 0 || chunk_dims[0] == 0 || chunk_dims[0] == 1,
+	"invalid chunk_dims[0] for rank 0");
+  
+  // stupid HDF5 has problems with rank 0
+  rank1 = rank == 0 ? 1 : rank;
+  
+  space_id = H5Dget_space(data_id);
+  
+  /*******************************************************************/
+  /* Before we can read the data from the data set, we must define
+     the dimensions and "selections" of the arrays to be read & written: */
+  
+  start_t *start = new start_t[rank1];
+  hsize_t *count = new hsize_t[rank1];
+  
+  int count_prod = 1;
+  for (int i = 0; i < rank; ++i) {
+    start[i] = chunk_start[i];
+    count[i] = chunk_dims[i];
+    count_prod *= count[i];
+  }
+  if (!rank) {
+    start[0] = 0;
+    count[0] = chunk_dims[0]; // see comment at top
+    count_prod *= count[0];
+  }
+  
+  if (count_prod > 0) {
+    H5Sselect_hyperslab(space_id, H5S_SELECT_SET,
+			start, NULL, count, NULL);
+    mem_space_id = H5Screate_simple(rank1, count, NULL);
+    H5Sselect_all(mem_space_id);
+  }
+  else { /* this can happen on leftover processes in MPI */
+    H5Sselect_none(space_id);
+    mem_space_id = H5Scopy(space_id); /* can't create an empty space */
+    H5Sselect_none(mem_space_id);
+    do_read = false; /* HDF5 complains about empty dataspaces */
+  }
+  
+  delete[] count;
+  delete[] start;
+  
+  /*******************************************************************/
+  /* Read the data, then free all the stuff we've allocated. */
+  
+  if (do_read)
+    H5Dread(data_id, REALNUM_H5T, mem_space_id, space_id, H5P_DEFAULT,
+	    (void *) data);
+  
+  H5Sclose(mem_space_id);
+  H5Sclose(space_id);
+#else
+  abort("not compiled with HDF5, required for HDF5 input");
+#endif
+}
+
+void h5file::open_data( const char * dataname )
+{
+	sync();
+#ifdef HAVE_HDF5
+
+	hid_t file_id = HID( get_id( ) );
+	hid_t data_id;
+	data_id = H5Dopen( file_id, dataname );
+	set_cur( dataname, &data_id );
+
+#else
+	abort("not compiled with HDF5, required for HDF5 input");
+#endif
+}
+
+void h5file::close_data( )
+{
+	sync();
+#ifdef HAVE_HDF5
+
+	unset_cur();
+
+#else
+	abort("not compiled with HDF5, required for HDF5 input");
+#endif
+}
+
+/* Collective close for files written with parallel == true: all processes
+   call this once after their last create_data/write_chunk.
+
+   With an MPI HDF5 this is just the collective H5Fclose.  In exclusive mode
+   the file is a token passed on in rank order by get_id/close_id, so
+   process n can only open it after process n-1 closed it; every process
+   therefore writes all its datasets first and only then hands the file on,
+   and nobody enters the final barrier while still holding it.  This avoids
+   the deadlock of a collective call inside the critical section, which
+   prevent_deadlock() only handles for extensible datasets. */
+void h5file::close_collective( )
+{
+	sync();
+	close_id();
+	if ( parallel )
+		all_wait();
+}
+
+/*****************************************************************************/
+/* Asynchronous writing.  After set_async( true ) the writing calls of a file
+   that makes no MPI calls ( parallel == false, or any file without MPI ) only
+   stage their data and queue a job for one writer thread per process.  The
+   jobs act on a twin h5file that the writer thread owns, in call order, so
+   time stepping goes on while the data go to disk.  The queue holds at most
+   async_limit bytes of staged data, beyond that the caller waits for the
+   writer; it always takes one job, so the next slice is staged while the
+   previous one is written.  The twin takes over the open file and its
+   extended datasets ( with their append buffers ) when it is created; every
+   other call on the file ( reads, remove, the destructor, ... ) first waits
+   for the twin's jobs and takes that state back, so appending goes on where
+   the twin left off.  flush() waits until everything is written.
+   Parallel files under MPI stay synchronous, their HDF5 calls are collective.
+   Needs pthreads ( CPPFLAGS=-DHAVE_PTHREAD and -pthread, see README.txt ),
+   otherwise all writes stay synchronous. */
+
+struct h5job {
+  int kind;
+  h5file *file;		// the twin
+  char *dataname;
+  int rank;
+  int *dims;		// [ rank + 1 ]
+  int *start;		// [ rank + 1 ], chunks only
+  realnum *data;	// staged copy
+  size_t bytes;
+  bool append_data;
+  bool single_precision;
+  int deflate;
+  bool shuffle;
+  h5job *next;
+};
+
+static bool async_on = false;
+static size_t async_limit = 256 << 20;
+static fields *async_timer = NULL;	// gets the OutputStaging / OutputWaiting times
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t h5q_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t h5q_work = PTHREAD_COND_INITIALIZER;	// jobs queued
+static pthread_cond_t h5q_done = PTHREAD_COND_INITIALIZER;	// a job finished
+static h5job *h5q_head = NULL;	// running job first, removed when finished
+static h5job *h5q_tail = NULL;
+static size_t h5q_bytes = 0;
+static bool h5q_started = false;
+static pthread_t h5q_thread;
+
+static void h5file_flush_at_exit() {
+  async_timer = NULL; // the fields may be gone
+  h5file::flush();
+}
+#endif
+
+/* Queue ( or without pthreads: none ) for all files; max_mb bounds the
+   staged data.  The time spent staging and waiting for the writer goes to
+   timer ( if given, it must outlive the asynchronous writes ) as
+   OutputStaging / OutputWaiting.  Switching off waits for the queued work. */
+void h5file::set_async(bool a, double max_mb, fields *timer)
+{
+  if (!a) flush();
+  async_on = a;
+  async_timer = a ? timer : NULL;
+  if (max_mb > 0) async_limit = (size_t) (max_mb * 1048576.0);
+#ifndef HAVE_PTHREAD
+  if (a) master_printf("h5file: compiled without HAVE_PTHREAD, writing synchronously\n");
+#endif
+}
+
+// true if this call goes to the writer thread
+bool h5file::async_here()
+{
+#ifdef HAVE_PTHREAD
+  if (!async_on || is_twin) return false;
+#  ifdef HAVE_MPI
+  if (parallel) return false; // collective calls stay on the main thread
+#  endif
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* Before a synchronous call: waits for the writer thread (for all files
+   unless HDF5 is thread safe) and takes the file back from its twin */
+void h5file::sync()
+{
+  if (is_twin) return;
+#ifndef H5_HAVE_THREADSAFE
+  flush();
+#endif
+  if (twin) {
+    wait_jobs();
+    swap_state(twin);
+    delete twin; // holds nothing open any more
+    twin = NULL;
+  }
+}
+
+/* Exchanges everything that describes the open file with other: ids,
+   current dataset, extended datasets with their append buffers and the
+   access mode ( WRITE until the file is created ) */
+void h5file::swap_state(h5file *other)
+{
+  std::swap(mode, other->mode);
+  std::swap(id, other->id);
+  std::swap(cur_id, other->cur_id);
+  std::swap(cur_dataname, other->cur_dataname);
+  std::swap(cur_append_data, other->cur_append_data);
+  std::swap(extending, other->extending);
+  std::swap(extend_block, other->extend_block);
+  std::swap(append_depth, other->append_depth);
+}
+
+// Waits until the writer thread has done every queued job of this file
+void h5file::wait_jobs()
+{
+#ifdef HAVE_PTHREAD
+  if (async_timer) async_timer->am_now_working_on(OutputWaiting);
+  pthread_mutex_lock(&h5q_lock);
+  for (;;) {
+    bool pending = false;
+    for (h5job *job = h5q_head; job && !pending; job = job->next)
+      pending = (job->file == twin);
+    if (!pending) break;
+    pthread_cond_wait(&h5q_done, &h5q_lock);
+  }
+  pthread_mutex_unlock(&h5q_lock);
+  if (async_timer) async_timer->finished_working();
+#endif
+}
+
+// Waits until all queued jobs of all files are written
+void h5file::flush()
+{
+#ifdef HAVE_PTHREAD
+  if (async_timer) async_timer->am_now_working_on(OutputWaiting);
+  pthread_mutex_lock(&h5q_lock);
+  while (h5q_head)
+    pthread_cond_wait(&h5q_done, &h5q_lock);
+  pthread_mutex_unlock(&h5q_lock);
+  if (async_timer) async_timer->finished_working();
+#endif
+}
+
+/* Stages the arguments of one call ( n realnums of data ) and queues it for
+   the twin, created here on first use with the state of this file. */
+void h5file::queue_job(int kind, const char *dataname, int rank,
+		       const int *dims, const int *start,
+		       const realnum *data, size_t n,
+		       bool append_data, bool single_precision,
+		       int deflate, bool shuffle)
+{
+#ifdef HAVE_PTHREAD
+  if (!twin) {
+    twin = new h5file(filename, mode, parallel);
+    twin->is_twin = true;
+    swap_state(twin);
+  }
+
+  if (async_timer) async_timer->am_now_working_on(OutputStaging);
+  h5job *job = new h5job;
+  job->kind = kind;
+  job->file = twin;
+  job->dataname = NULL;
+  if (dataname) {
+    job->dataname = new char[strlen(dataname) + 1];
+    strcpy(job->dataname, dataname);
+  }
+  job->rank = rank;
+  job->dims = new int[rank + 1];
+  job->start = new int[rank + 1];
+  for (int i = 0; i <= rank; ++i) {
+    job->dims[i] = dims && (i < rank || !rank) ? dims[i] : 1;
+    job->start[i] = start && (i < rank || !rank) ? start[i] : 0;
+  }
+  job->data = NULL;
+  job->bytes = data ? n * sizeof(realnum) : 0;
+  if (data && n) {
+    job->data = new realnum[n];
+    memcpy(job->data, data, n * sizeof(realnum));
+  }
+  job->append_data = append_data;
+  job->single_precision = single_precision;
+  job->deflate = deflate;
+  job->shuffle = shuffle;
+  job->next = NULL;
+  if (async_timer) async_timer->finished_working();
+
+  if (async_timer) async_timer->am_now_working_on(OutputWaiting);
+  pthread_mutex_lock(&h5q_lock);
+  if (!h5q_started) {
+    if (pthread_create(&h5q_thread, NULL, writer_main, NULL))
+      abort("h5file: cannot start the writer thread\n");
+    pthread_detach(h5q_thread);
+    atexit(h5file_flush_at_exit);
+    h5q_started = true;
+  }
+  while (h5q_head && h5q_bytes + job->bytes > async_limit)
+    pthread_cond_wait(&h5q_done, &h5q_lock);
+  if (h5q_tail)
+    h5q_tail->next = job;
+  else
+    h5q_head = job;
+  h5q_tail = job;
+  h5q_bytes += job->bytes;
+  pthread_cond_signal(&h5q_work);
+  pthread_mutex_unlock(&h5q_lock);
+  if (async_timer) async_timer->finished_working();
+#else
+  (void) kind; (void) dataname; (void) rank; (void) dims; (void) start;
+  (void) data; (void) n; (void) append_data; (void) single_precision;
+  (void) deflate; (void) shuffle;
+#endif
+}
+
+// Performs one job on the twin, writer thread only
+void h5file::run_job(void *job_)
+{
+  h5job *job = (h5job *) job_;
+  h5file *f = job->file;
+  switch (job->kind) {
+  case H5JOB_CREATE:
+    f->create_data(job->dataname, job->rank, job->dims, job->append_data,
+		   job->single_precision, job->deflate, job->shuffle);
+    break;
+  case H5JOB_CREATE_OR_EXTEND:
+    f->create_or_extend_data(job->dataname, job->rank, job->dims,
+			     job->append_data, job->single_precision);
+    break;
+  case H5JOB_EXTEND:
+    f->extend_data(job->dataname, job->rank, job->dims);
+    break;
+  case H5JOB_CHUNK:
+    f->write_chunk(job->rank, job->start, job->dims, job->data);
+    break;
+  case H5JOB_DONE:
+    f->done_writing_chunks();
+    break;
+  case H5JOB_WRITE:
+    f->create_data(job->dataname, job->rank, job->dims, false,
+		   job->single_precision, job->deflate, job->shuffle);
+    if (job->data)
+      f->write_chunk(job->rank, job->start, job->dims, job->data);
+    f->done_writing_chunks();
+    f->unset_cur();
+    break;
+  }
+}
+
+void *h5file::writer_main(void *)
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h5q_lock);
+  for (;;) {
+    while (!h5q_head)
+      pthread_cond_wait(&h5q_work, &h5q_lock);
+    h5job *job = h5q_head;
+    pthread_mutex_unlock(&h5q_lock);
+
+    run_job(job);
+
+    pthread_mutex_lock(&h5q_lock);
+    h5q_head = job->next;
+    if (!h5q_head) h5q_tail = NULL;
+    h5q_bytes -= job->bytes;
+    pthread_cond_broadcast(&h5q_done);
+    delete[] job->dataname;
+    delete[] job->dims;
+    delete[] job->start;
+    delete[] job->data;
+    delete job;
+  }
+#endif
+  return NULL;
+}
+
+} // namespace meep